@@ -0,0 +1,297 @@
+#include "Detection.h"
+#include "Logging.h"
+
+#include <tensorflow/core/example/example.pb.h>
+#include <tensorflow/core/lib/io/record_reader.h>
+
+#include <algorithm>
+#include <iomanip>
+
+struct EvalImage
+{
+    cv::Mat image;
+    std::vector< MajorProject::BoundingBox > ground_truth;
+};
+
+struct EvalResult
+{
+    double average_precision;
+    double images_per_second;
+    double mean_latency;
+    double p95_latency;
+    // "kernels", "weights" (8-bit storage, float compute) or "no"
+    std::string quantized;
+};
+
+/*
+ * @LoadRecord	Loads images and ground truth boxes from a TFRecord written by tfrecord.py
+ *
+ * @return	-1 on failure, 0 otherwise
+ */
+int LoadRecord( std::string& record_path, std::vector< EvalImage >& images )
+{
+    std::unique_ptr< tensorflow::RandomAccessFile > file;
+    tensorflow::Status status = tensorflow::Env::Default()->NewRandomAccessFile( record_path, &file );
+    if( !status.ok() )
+    {
+        std::cerr << status.ToString() << std::endl;
+        return -1;
+    }
+
+    tensorflow::io::RecordReader reader( file.get() );
+    tensorflow::uint64 offset = 0;
+    std::string record;
+    while( reader.ReadRecord( &offset, &record ).ok() )
+    {
+        tensorflow::Example example;
+        if( !example.ParseFromString( record ) )
+        {
+            std::cerr << "Failed to parse example at offset " << offset << std::endl;
+            return -1;
+        }
+
+        const auto& features = example.features().feature();
+        const std::string& encoded = features.at( "image/encoded" ).bytes_list().value( 0 );
+        EvalImage eval_image;
+        eval_image.image = cv::imdecode( cv::Mat( 1, encoded.size(), CV_8UC1, (void*)encoded.data() ), cv::IMREAD_COLOR );
+        if( eval_image.image.empty() )
+        {
+            std::cerr << "Failed to decode image at offset " << offset << std::endl;
+            return -1;
+        }
+
+        const auto& x_mins = features.at( "image/object/bbox/xmin" ).float_list().value();
+        const auto& x_maxs = features.at( "image/object/bbox/xmax" ).float_list().value();
+        const auto& y_mins = features.at( "image/object/bbox/ymin" ).float_list().value();
+        const auto& y_maxs = features.at( "image/object/bbox/ymax" ).float_list().value();
+        const auto& labels = features.at( "image/object/class/label" ).int64_list().value();
+        for( int i = 0; i < x_mins.size(); i++ )
+        {
+            MajorProject::BoundingBox box;
+            box.x_min = std::max( 0.0f, x_mins[ i ] ) * eval_image.image.cols;
+            box.x_max = std::max( 0.0f, x_maxs[ i ] ) * eval_image.image.cols;
+            box.y_min = std::max( 0.0f, y_mins[ i ] ) * eval_image.image.rows;
+            box.y_max = std::max( 0.0f, y_maxs[ i ] ) * eval_image.image.rows;
+            box.label_id = labels[ i ];
+            box.confidence = 1.0f;
+            eval_image.ground_truth.push_back( box );
+        }
+
+        images.push_back( eval_image );
+    }
+
+    return 0;
+}
+
+double IntersectionOverUnion( const MajorProject::BoundingBox& a, const MajorProject::BoundingBox& b )
+{
+    double width = (double)std::min( a.x_max, b.x_max ) - (double)std::max( a.x_min, b.x_min );
+    double height = (double)std::min( a.y_max, b.y_max ) - (double)std::max( a.y_min, b.y_min );
+    if( width <= 0 || height <= 0 )
+    {
+        return 0.0;
+    }
+    double intersection = width * height;
+    double area_a = ( (double)a.x_max - a.x_min ) * ( (double)a.y_max - a.y_min );
+    double area_b = ( (double)b.x_max - b.x_min ) * ( (double)b.y_max - b.y_min );
+    return intersection / ( area_a + area_b - intersection );
+}
+
+/*
+ * @AveragePrecision	PASCAL VOC style AP (all points interpolated) at the given IoU threshold
+ */
+double AveragePrecision( std::vector< EvalImage >& images,
+                         std::vector< std::vector< MajorProject::BoundingBox > >& detections,
+                         double iou_threshold )
+{
+    // ( confidence, true positive )
+    std::vector< std::pair< float, bool > > ranked;
+    size_t total_ground_truth = 0;
+    for( size_t i = 0; i < images.size(); i++ )
+    {
+        auto& ground_truth = images[ i ].ground_truth;
+        total_ground_truth += ground_truth.size();
+
+        std::vector< MajorProject::BoundingBox > sorted = detections[ i ];
+        std::sort( sorted.begin(),
+                   sorted.end(),
+                   []( const MajorProject::BoundingBox& a, const MajorProject::BoundingBox& b ) {
+                       return a.confidence > b.confidence;
+                   } );
+
+        std::vector< bool > matched( ground_truth.size(), false );
+        for( const auto& detection : sorted )
+        {
+            double best_iou = 0.0;
+            ssize_t best_match = -1;
+            for( size_t j = 0; j < ground_truth.size(); j++ )
+            {
+                double iou = IntersectionOverUnion( detection, ground_truth[ j ] );
+                if( iou > best_iou )
+                {
+                    best_iou = iou;
+                    best_match = j;
+                }
+            }
+
+            bool true_positive = best_match != -1 && best_iou >= iou_threshold && !matched[ best_match ];
+            if( true_positive )
+            {
+                matched[ best_match ] = true;
+            }
+            ranked.push_back( { detection.confidence, true_positive } );
+        }
+    }
+
+    if( total_ground_truth == 0 )
+    {
+        return 0.0;
+    }
+
+    std::sort( ranked.begin(), ranked.end(), []( const std::pair< float, bool >& a, const std::pair< float, bool >& b ) {
+        return a.first > b.first;
+    } );
+
+    std::vector< double > precision( ranked.size() );
+    std::vector< double > recall( ranked.size() );
+    size_t true_positives = 0;
+    for( size_t i = 0; i < ranked.size(); i++ )
+    {
+        true_positives += ranked[ i ].second ? 1 : 0;
+        precision[ i ] = (double)true_positives / ( i + 1 );
+        recall[ i ] = (double)true_positives / total_ground_truth;
+    }
+
+    // Make precision monotonically decreasing then integrate over recall
+    for( ssize_t i = (ssize_t)ranked.size() - 2; i >= 0; i-- )
+    {
+        precision[ i ] = std::max( precision[ i ], precision[ i + 1 ] );
+    }
+    double average_precision = 0.0;
+    double previous_recall = 0.0;
+    for( size_t i = 0; i < ranked.size(); i++ )
+    {
+        average_precision += ( recall[ i ] - previous_recall ) * precision[ i ];
+        previous_recall = recall[ i ];
+    }
+
+    return average_precision;
+}
+
+int EvaluateModel( MajorProject::Detector& detector,
+                   std::string& model_path,
+                   std::vector< EvalImage >& images,
+                   EvalResult& result )
+{
+    if( detector.InitSession( model_path ) == -1 )
+    {
+        return -1;
+    }
+    result.quantized = detector.IsQuantized() ? "kernels" : ( detector.HasQuantizedWeights() ? "weights" : "no" );
+
+    // Warm up so graph optimisation and allocation is not included in the timings
+    std::vector< cv::Mat* > frames = { &images[ 0 ].image };
+    MajorProject::Detections frame_detections;
+    if( detector.DetectFrames( frames, frame_detections ) == -1 )
+    {
+        return -1;
+    }
+
+    std::vector< std::vector< MajorProject::BoundingBox > > detections( images.size() );
+    std::vector< double > latencies;
+    latencies.reserve( images.size() );
+    auto total_start = std::chrono::steady_clock::now();
+    for( size_t i = 0; i < images.size(); i++ )
+    {
+        frames[ 0 ] = &images[ i ].image;
+        auto start = std::chrono::steady_clock::now();
+        if( detector.DetectFrames( frames, frame_detections ) == -1 )
+        {
+            return -1;
+        }
+        auto end = std::chrono::steady_clock::now();
+        latencies.push_back( std::chrono::duration< double, std::milli >( end - start ).count() );
+        for( size_t j = 0; j < frame_detections.Size(); j++ )
+        {
+            MajorProject::BoundingBox box;
+            box.x_min = frame_detections.x_min[ j ];
+            box.x_max = frame_detections.x_max[ j ];
+            box.y_min = frame_detections.y_min[ j ];
+            box.y_max = frame_detections.y_max[ j ];
+            box.label_id = frame_detections.label_id[ j ];
+            box.confidence = frame_detections.confidence[ j ];
+            detections[ i ].push_back( box );
+        }
+    }
+    auto total_end = std::chrono::steady_clock::now();
+    double total_seconds = std::chrono::duration< double >( total_end - total_start ).count();
+
+    std::sort( latencies.begin(), latencies.end() );
+    double latency_sum = 0.0;
+    for( const auto& latency : latencies )
+    {
+        latency_sum += latency;
+    }
+
+    result.average_precision = AveragePrecision( images, detections, 0.5 );
+    result.images_per_second = images.size() / total_seconds;
+    result.mean_latency = latency_sum / latencies.size();
+    result.p95_latency = latencies[ std::min( latencies.size() - 1, ( size_t )( latencies.size() * 0.95 ) ) ];
+
+    return detector.CloseSession();
+}
+
+int main( int argc, char** argv )
+{
+    if( argc < 3 )
+    {
+        std::cout << "Usage: " << argv[ 0 ] << " test-record model-pb [model-pb ...]" << std::endl;
+        return -1;
+    }
+    std::string record_path( argv[ 1 ] );
+
+    std::vector< EvalImage > images;
+    if( LoadRecord( record_path, images ) == -1 || images.empty() )
+    {
+        std::cerr << "No images loaded from " << record_path << std::endl;
+        return -1;
+    }
+
+    MajorProject::Logger* logger = new MajorProject::Logger( ".", "" );
+    MajorProject::Detector detector( logger );
+    // Low threshold so the precision/recall curve covers the whole operating range
+    detector.SetConfidenceThreshold( 0.01 );
+    detector.SetBatchSize( 1 );
+    detector.SetGpuDeviceId( -1 );
+    detector.SetTensorflowLogLevel( 2 );
+    detector.SetTensorflowVLogLevel( 3 );
+
+    std::vector< EvalResult > results;
+    for( int i = 2; i < argc; i++ )
+    {
+        std::string model_path( argv[ i ] );
+        EvalResult result;
+        if( EvaluateModel( detector, model_path, images, result ) == -1 )
+        {
+            std::cerr << "Failed to evaluate " << model_path << std::endl;
+            return -1;
+        }
+        results.push_back( result );
+    }
+
+    std::cout << images.size() << " images from " << record_path << std::endl;
+    std::cout << std::left << std::setw( 48 ) << "model" << std::setw( 11 ) << "quantized" << std::setw( 10 ) << "AP@0.5"
+              << std::setw( 12 ) << "images/s" << std::setw( 14 ) << "mean ms" << std::setw( 14 ) << "p95 ms"
+              << std::endl;
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        std::cout << std::left << std::setw( 48 ) << argv[ i + 2 ] << std::setw( 11 )
+                  << results[ i ].quantized << std::fixed << std::setprecision( 4 ) << std::setw( 10 )
+                  << results[ i ].average_precision << std::setprecision( 2 ) << std::setw( 12 )
+                  << results[ i ].images_per_second << std::setw( 14 ) << results[ i ].mean_latency << std::setw( 14 )
+                  << results[ i ].p95_latency << std::endl;
+    }
+
+    delete logger;
+    return 0;
+}
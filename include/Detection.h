@@ -3,6 +3,7 @@
 #include <tensorflow/core/public/session.h>
 #include <tensorflow/core/platform/env.h>
 #include "tensorflow/core/graph/default_device.h"
+#include "tensorflow/core/util/memmapped_file_system.h"
 #include <pthread.h>
 #include <chrono>
 
@@ -15,15 +16,23 @@ class Detector
 public:
     Detector( Logger* _logger )
         : session( nullptr )
-        , graph( nullptr )
         , confidence_threshold( 0.5 )
-        , label_map( { { 1, "face" } } )
         , logger( _logger )
         , batch_size( 1 )
         , session_gpu_memory_fraction( 0.8 )
         , allow_growth( true )
         , gpu_device_id( -1 )
+        , quantized( false )
+        , quantized_weights( false )
+        , tiling( false )
+        , tile_size( 300 )
+        , tile_overlap( 0.25 )
+        , tile_full_view( true )
+        , nms_threshold( 0.5 )
+        , memmapped_model( false )
     {
+        SetLabelMap( { { 1, "face" } } );
+
         // Does not overwrite env variable if it is set
         setenv( "TF_CPP_MIN_LOG_LEVEL", "2", 0 );
         setenv( "TF_CPP_MIN_VLOG_LEVEL", "3", 0 );
@@ -75,6 +84,41 @@ public:
         return 0;
     }
 
+    /*
+     * @DetectFrames	Detects objects in a batch of frames without logging or visualising them
+     *
+     * @param frames	Frames to process. All frames must have the same dimensions
+     * @param detections	Filled with the detections above the confidence threshold for the whole batch
+     *
+     * @return	-1 on failure, 0 otherwise
+     */
+    int DetectFrames( std::vector< cv::Mat* >& frames, Detections& detections );
+
+    /*
+     * @GetLabelNames	Label table indexed by label_id. Empty strings are ids not in the label map
+     */
+    const std::vector< std::string >& GetLabelNames()
+    {
+        return label_names;
+    }
+
+    /*
+     * @IsQuantized	Whether the loaded model runs 8-bit quantized kernels (tools/quantize_model.sh full)
+     */
+    bool IsQuantized()
+    {
+        return quantized;
+    }
+
+    /*
+     * @HasQuantizedWeights	Whether the loaded model stores 8-bit weights (tools/quantize_model.sh weights). Without
+     * quantized kernels these are dequantized when the session is created and the model runs in float
+     */
+    bool HasQuantizedWeights()
+    {
+        return quantized_weights;
+    }
+
 
     /*
      * @SetConfidenceThreshold	Sets the level of confidence for a positive identification. Between 0 and 1
@@ -90,7 +134,15 @@ public:
      */
     void SetLabelMap( std::map< size_t, std::string >&& _label_map )
     {
-        label_map = _label_map;
+        // Flattened so post-processing looks labels up by index instead of searching the map per box
+        size_t num_labels = _label_map.empty() ? 1 : _label_map.rbegin()->first + 1;
+        label_names.assign( num_labels, "" );
+        label_valid.assign( num_labels, 0 );
+        for( const auto& label : _label_map )
+        {
+            label_names[ label.first ] = label.second;
+            label_valid[ label.first ] = 1;
+        }
     }
 
     /*
@@ -133,6 +185,60 @@ public:
         gpu_device_id = _gpu_device_id;
     }
 
+    /*
+     * @SetMemmappedModel	Sets whether InitSession expects a model converted with tools/memmap_model.sh. Weights are
+     * then mapped from the file instead of read onto the heap and are shared between processes
+     */
+    void SetMemmappedModel( bool _memmapped_model )
+    {
+        memmapped_model = _memmapped_model;
+    }
+
+    /*
+     * @SetTiling	Sets whether frames are cut into overlapping model sized tiles instead of being resized by the model.
+     * Improves recall of small objects in high resolution frames
+     */
+    void SetTiling( bool _tiling )
+    {
+        tiling = _tiling;
+    }
+
+    /*
+     * @SetTileSize	Sets width and height of tiles in pixels. Should match the model input size (300 for SSD).
+     * At least 1
+     */
+    void SetTileSize( size_t _tile_size )
+    {
+        tile_size = std::max( _tile_size, (size_t)1 );
+    }
+
+    /*
+     * @SetTileOverlap	Sets fraction of a tile shared with its neighbours. Clamped to between 0 and 0.9 as the tile
+     * count, and so the batch size, grows with the inverse square of ( 1 - overlap )
+     */
+    void SetTileOverlap( double _tile_overlap )
+    {
+        tile_overlap = std::min( std::max( _tile_overlap, 0.0 ), 0.9 );
+    }
+
+    /*
+     * @SetTileFullView	Sets whether a downscaled copy of the whole frame is detected alongside the tiles
+     */
+    void SetTileFullView( bool _tile_full_view )
+    {
+        tile_full_view = _tile_full_view;
+    }
+
+    /*
+     * @SetNmsThreshold	Sets overlap above which boxes from different tiles are merged. Overlap is measured as the
+     * intersection over the area of the smaller box so a face cut off at a tile edge merges with the whole face.
+     * Between 0 and 1
+     */
+    void SetNmsThreshold( double _nms_threshold )
+    {
+        nms_threshold = _nms_threshold;
+    }
+
     /*
      * @SetTensorflowLogLevel	Sets log level for tensorflow. Options are INFO=0, WARNING=1, ERROR=2 and FATAL=3
      *
@@ -158,19 +264,30 @@ private:
 
     int DetectObjects( tensorflow::Tensor& image_tensor, std::vector< tensorflow::Tensor >& outputs );
 
-    int VisualiseDetection( std::vector< cv::Mat* >& frame, std::vector< tensorflow::Tensor >& detection_results );
+    int DetectTiled( std::vector< cv::Mat* >& frames, Detections& detections );
+
+    void ComputeTiles( cv::Mat& frame, std::vector< cv::Rect >& tiles );
+
+    void FilterDetections( const float* boxes,
+                           const float* scores,
+                           const float* classes,
+                           size_t count,
+                           const cv::Rect& source,
+                           Detections& detections );
+
+    int VisualiseDetection( std::vector< cv::Mat* >& frames, Detections& detections );
 
     int LogDetection( LogType log_type,
-                      std::vector< cv::Mat* > frames,
-                      std::vector< tensorflow::Tensor >& detection_results,
+                      Detections& detections,
                       std::string& file_name,
                       std::string& outfile_name,
-                      std::vector< size_t > frame_ids );
+                      std::vector< size_t >& frame_ids );
 
     tensorflow::Session* session;
-    tensorflow::GraphDef* graph;
+    std::unique_ptr< tensorflow::MemmappedEnv > memmapped_env;
     double confidence_threshold;
-    std::map< size_t, std::string > label_map;
+    std::vector< std::string > label_names;
+    std::vector< uint8_t > label_valid;
     Logger* logger;
     size_t batch_size;
 
@@ -178,5 +295,16 @@ private:
     bool allow_growth;
 
     size_t gpu_device_id;
+
+    bool quantized;
+    bool quantized_weights;
+
+    bool tiling;
+    size_t tile_size;
+    double tile_overlap;
+    bool tile_full_view;
+    double nms_threshold;
+
+    bool memmapped_model;
 };
 }
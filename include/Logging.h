@@ -6,6 +6,7 @@
 #include <iostream>
 #include <sstream>
 #include <limits.h>
+#include <stdint.h>
 
 namespace MajorProject
 {
@@ -35,6 +36,44 @@ struct BoundingBox
     std::string label;
 };
 
+/*
+ * Detections for a batch of frames as a structure of arrays. Coordinates are in frame pixels. The detections of
+ * frame i are the indices [ frame_offsets[ i ], frame_offsets[ i + 1 ] ). Labels are looked up by label_id in the
+ * detector's label table.
+ */
+struct Detections
+{
+    std::vector< float > x_min;
+    std::vector< float > x_max;
+    std::vector< float > y_min;
+    std::vector< float > y_max;
+    std::vector< float > confidence;
+    std::vector< uint32_t > label_id;
+
+    std::vector< size_t > frame_offsets;
+
+    size_t Size()
+    {
+        return confidence.size();
+    }
+
+    void Resize( size_t size )
+    {
+        x_min.resize( size );
+        x_max.resize( size );
+        y_min.resize( size );
+        y_max.resize( size );
+        confidence.resize( size );
+        label_id.resize( size );
+    }
+
+    void Clear()
+    {
+        Resize( 0 );
+        frame_offsets.assign( 1, 0 );
+    }
+};
+
 class Logger
 {
 public:
@@ -56,6 +95,19 @@ public:
                       std::string& outfile,
                       ssize_t frame_id = -1 );
 
+    /*
+     * @LogDetection	Logs the detections of one frame of a batch
+     *
+     * @param label_names	Label table indexed by label_id
+     */
+    int LogDetection( LogType log_type,
+                      Detections& detections,
+                      size_t frame,
+                      std::vector< std::string >& label_names,
+                      std::string& infile,
+                      std::string& outfile,
+                      ssize_t frame_id = -1 );
+
     void LogError( std::string error_message, ErrorType error );
 
     void SetDataDir( std::string& _data_directory )
@@ -80,6 +132,7 @@ public:
 private:
     std::string GetErrorString( ErrorType error );
     std::string EscapeInfile( std::string& infile );
+    int OpenWriter( std::ofstream& writer, std::string& infile, std::string& outfile );
 
     std::string data_directory;
     std::string error_file;
@@ -10,20 +10,51 @@ int Detector::InitSession( std::string& model_path )
     tensorflow::Status status;
     tensorflow::SessionOptions opts;
 
-
-    if( graph )
+    // Only needed until the session is created, the session keeps its own copy of the graph
+    tensorflow::GraphDef graph;
+    if( memmapped_model )
     {
-        delete graph;
+        // Constant weights stay in the file and are mapped read only, so processes loading the same model share them
+        memmapped_env.reset( new tensorflow::MemmappedEnv( tensorflow::Env::Default() ) );
+        status = memmapped_env->InitializeFromFile( model_path );
+        if( status.ok() )
+        {
+            status = tensorflow::ReadBinaryProto(
+            memmapped_env.get(), tensorflow::MemmappedFileSystem::kMemmappedPackageDefaultGraphDef, &graph );
+        }
+        opts.env = memmapped_env.get();
+        // Optimisations such as constant folding would copy the mapped weights back onto the heap
+        opts.config.mutable_graph_options()->mutable_optimizer_options()->set_opt_level(
+        tensorflow::OptimizerOptions::L0 );
+    }
+    else
+    {
+        status = tensorflow::ReadBinaryProto( tensorflow::Env::Default(), model_path, &graph );
     }
-    graph = new tensorflow::GraphDef();
-    status = tensorflow::ReadBinaryProto( tensorflow::Env::Default(), model_path, graph );
-    tensorflow::graph::SetDefaultDevice(
-    ( gpu_device_id == -1 ) ? "/cpu:0" : ( "/gpu:" + std::to_string( gpu_device_id ) ), graph );
     if( !status.ok() )
     {
         logger->LogError( status.ToString(), ErrorType::FATAL );
         return -1;
     }
+    tensorflow::graph::SetDefaultDevice(
+    ( gpu_device_id == -1 ) ? "/cpu:0" : ( "/gpu:" + std::to_string( gpu_device_id ) ), &graph );
+
+    // Quantized graphs load like any other frozen graph, the quantized kernels are part of tensorflow_cc.
+    // A Dequantize on its own only means 8-bit weights, which are folded back to float constants on session creation
+    quantized = false;
+    quantized_weights = false;
+    for( const auto& node : graph.node() )
+    {
+        const std::string& op = node.op();
+        if( op.compare( 0, 9, "Quantized" ) == 0 || op == "QuantizeV2" || op == "Requantize" )
+        {
+            quantized = true;
+        }
+        else if( op == "Dequantize" )
+        {
+            quantized_weights = true;
+        }
+    }
 
     opts.config.mutable_gpu_options()->set_per_process_gpu_memory_fraction( session_gpu_memory_fraction );
     opts.config.mutable_gpu_options()->set_allow_growth( allow_growth );
@@ -39,7 +70,7 @@ int Detector::InitSession( std::string& model_path )
     }
 
     // Add the graph to the session
-    status = session->Create( *graph );
+    status = session->Create( graph );
     if( !status.ok() )
     {
         logger->LogError( status.ToString(), ErrorType::FATAL );
@@ -59,12 +90,11 @@ int Detector::CloseSession()
             logger->LogError( status.ToString(), ErrorType::FATAL );
             return -1;
         }
+        delete session;
         session = nullptr;
     }
-    if( graph )
-    {
-        delete graph;
-    }
+    // Must outlive the session as its kernels read weights from the mapped file
+    memmapped_env.reset();
     return 0;
 }
 
@@ -158,6 +188,8 @@ int Detector::ProcMP4( std::string& mp4_path, std::string outfile_name, bool vis
     std::vector< size_t > frame_ids;
     frames.reserve( batch_size );
     frame_ids.reserve( batch_size );
+    // Reused across batches so its arrays are only allocated once
+    Detections detections;
 
     int return_code = 0;
     for( size_t i = 0; i < frame_count; i++ )
@@ -178,16 +210,13 @@ int Detector::ProcMP4( std::string& mp4_path, std::string outfile_name, bool vis
         {
             auto start = std::chrono::steady_clock::now();
 
-            tensorflow::Tensor input_tensor = CreateTensor( frames );
-
-            std::vector< tensorflow::Tensor > output_tensors;
-            if( DetectObjects( input_tensor, output_tensors ) == -1 )
+            if( DetectFrames( frames, detections ) == -1 )
             {
                 return_code = -1;
                 break;
             }
 
-            if( LogDetection( LogType::MP4, frames, output_tensors, mp4_path, outfile_name, frame_ids ) == -1 )
+            if( LogDetection( LogType::MP4, detections, mp4_path, outfile_name, frame_ids ) == -1 )
             {
                 return_code = -1;
                 break;
@@ -195,7 +224,7 @@ int Detector::ProcMP4( std::string& mp4_path, std::string outfile_name, bool vis
 
             if( visualise )
             {
-                if( VisualiseDetection( frames, output_tensors ) == -1 )
+                if( VisualiseDetection( frames, detections ) == -1 )
                 {
                     return_code = -1;
                     break;
@@ -206,6 +235,13 @@ int Detector::ProcMP4( std::string& mp4_path, std::string outfile_name, bool vis
                     frame_queue.push( frames[ j ] );
                 }
             }
+            else
+            {
+                for( size_t j = 0; j < frames.size(); j++ )
+                {
+                    delete frames[ j ];
+                }
+            }
 
             frames.clear();
             frame_ids.clear();
@@ -243,23 +279,288 @@ tensorflow::Tensor Detector::CreateTensor( std::vector< cv::Mat* >& frames )
     int channels = frames[ 0 ]->channels();
     tensorflow::Tensor frame_tensor(
     tensorflow::DT_UINT8,
-    tensorflow::TensorShape( { (int)batch_size, frames[ 0 ]->rows, frames[ 0 ]->cols, channels } ) );
-    auto mapped_frame = frame_tensor.tensor< uint8_t, 4 >();
-    for( size_t h = 0; h < batch_size; h++ )
+    tensorflow::TensorShape( { (int)frames.size(), frames[ 0 ]->rows, frames[ 0 ]->cols, channels } ) );
+    uint8_t* tensor_data = frame_tensor.flat< uint8_t >().data();
+    size_t row_bytes = frames[ 0 ]->cols * channels;
+    for( size_t h = 0; h < frames.size(); h++ )
+    {
+        // Copy row by row as frames may be views into a larger image (e.g. tiles) with padded rows
+        cv::Mat& frame = *frames[ h ];
+        for( int i = 0; i < frame.rows; i++ )
+        {
+            memcpy( tensor_data, frame.ptr< uint8_t >( i ), row_bytes );
+            tensor_data += row_bytes;
+        }
+    }
+
+    return frame_tensor;
+}
+
+int Detector::DetectFrames( std::vector< cv::Mat* >& frames, Detections& detections )
+{
+    if( !session )
+    {
+        logger->LogError( "Session is not initialised", ErrorType::FATAL );
+        return -1;
+    }
+    detections.Clear();
+    if( frames.empty() )
+    {
+        return 0;
+    }
+
+    if( tiling )
+    {
+        return DetectTiled( frames, detections );
+    }
+
+    tensorflow::Tensor input_tensor = CreateTensor( frames );
+
+    std::vector< tensorflow::Tensor > output_tensors;
+    if( DetectObjects( input_tensor, output_tensors ) == -1 )
+    {
+        return -1;
+    }
+
+    const float* boxes = output_tensors[ 0 ].flat< float >().data();
+    const float* scores = output_tensors[ 1 ].flat< float >().data();
+    const float* classes = output_tensors[ 2 ].flat< float >().data();
+    const float* num_detections = output_tensors[ 3 ].flat< float >().data();
+    size_t max_detections = output_tensors[ 1 ].dim_size( 1 );
+
+    cv::Rect source( 0, 0, frames[ 0 ]->cols, frames[ 0 ]->rows );
+    for( size_t i = 0; i < frames.size(); i++ )
+    {
+        size_t offset = i * max_detections;
+        FilterDetections( boxes + offset * 4,
+                          scores + offset,
+                          classes + offset,
+                          (size_t)num_detections[ i ],
+                          source,
+                          detections );
+        detections.frame_offsets.push_back( detections.Size() );
+    }
+
+    return 0;
+}
+
+void Detector::FilterDetections( const float* boxes,
+                                 const float* scores,
+                                 const float* classes,
+                                 size_t count,
+                                 const cv::Rect& source,
+                                 Detections& detections )
+{
+    // Threshold and class range test. No dependency between iterations so the compiler vectorises it. The mask is
+    // local so concurrent DetectFrames calls (e.g. from python threads) share no mutable state
+    std::vector< uint8_t > keep_mask( count );
+    uint8_t* keep = keep_mask.data();
+    float threshold = confidence_threshold;
+    float num_labels = label_valid.size();
+    for( size_t j = 0; j < count; j++ )
+    {
+        keep[ j ] = ( scores[ j ] >= threshold ) & ( classes[ j ] >= 0.0f ) & ( classes[ j ] < num_labels );
+    }
+
+    // Compact the kept boxes. Boxes are [ y_min, x_min, y_max, x_max ] normalised to the source rectangle
+    size_t out = detections.Size();
+    detections.Resize( out + count );
+    float* x_min = detections.x_min.data();
+    float* x_max = detections.x_max.data();
+    float* y_min = detections.y_min.data();
+    float* y_max = detections.y_max.data();
+    float* confidence = detections.confidence.data();
+    uint32_t* label_id = detections.label_id.data();
+    for( size_t j = 0; j < count; j++ )
+    {
+        if( !keep[ j ] )
+        {
+            continue;
+        }
+        // Only cast once the mask has excluded negative and NaN classes
+        size_t box_class = (size_t)classes[ j ];
+        if( !label_valid[ box_class ] )
+        {
+            continue;
+        }
+        y_min[ out ] = source.y + boxes[ j * 4 + 0 ] * source.height;
+        x_min[ out ] = source.x + boxes[ j * 4 + 1 ] * source.width;
+        y_max[ out ] = source.y + boxes[ j * 4 + 2 ] * source.height;
+        x_max[ out ] = source.x + boxes[ j * 4 + 3 ] * source.width;
+        confidence[ out ] = scores[ j ];
+        label_id[ out ] = box_class;
+        out++;
+    }
+
+    detections.Resize( out );
+}
+
+void Detector::ComputeTiles( cv::Mat& frame, std::vector< cv::Rect >& tiles )
+{
+    int tile_width = std::min( (int)tile_size, frame.cols );
+    int tile_height = std::min( (int)tile_size, frame.rows );
+    int stride_x = std::max( 1, (int)( tile_width * ( 1.0 - tile_overlap ) ) );
+    int stride_y = std::max( 1, (int)( tile_height * ( 1.0 - tile_overlap ) ) );
+
+    // The last tile in each row and column is shifted back inside the frame so all tiles are the same size
+    for( int y = 0;; y += stride_y )
     {
-        cv::Mat frame = *frames[ h ];
-        for( size_t i = 0; i < frame.rows; i++ )
+        int tile_y = std::min( y, frame.rows - tile_height );
+        for( int x = 0;; x += stride_x )
         {
-            for( size_t j = 0; j < frame.cols; j++ )
+            int tile_x = std::min( x, frame.cols - tile_width );
+            tiles.push_back( cv::Rect( tile_x, tile_y, tile_width, tile_height ) );
+            if( tile_x + tile_width >= frame.cols )
             {
-                mapped_frame( h, i, j, 0 ) = frame.data[ ( i * frame.cols + j ) * channels + 0 ];
-                mapped_frame( h, i, j, 1 ) = frame.data[ ( i * frame.cols + j ) * channels + 1 ];
-                mapped_frame( h, i, j, 2 ) = frame.data[ ( i * frame.cols + j ) * channels + 2 ];
+                break;
             }
         }
+        if( tile_y + tile_height >= frame.rows )
+        {
+            break;
+        }
     }
+}
 
-    return frame_tensor;
+/*
+ * @NonMaxSuppression	Greedy class aware NMS. Returns indices of kept candidates in decreasing confidence
+ *
+ * Overlap is intersection over the smaller box rather than IoU. A fragment of a face cut off at a tile edge, or a
+ * tile box inside a larger full view box, lies mostly inside the whole box but has a low IoU with it. Only boxes from
+ * different views are compared, boxes from the same view were already suppressed by the model.
+ *
+ * @param views	View (tile or full view) index of each candidate
+ */
+std::vector< size_t > NonMaxSuppression( Detections& candidates,
+                                         std::vector< uint32_t >& views,
+                                         float overlap_threshold )
+{
+    size_t count = candidates.Size();
+    std::vector< size_t > order( count );
+    for( size_t i = 0; i < count; i++ )
+    {
+        order[ i ] = i;
+    }
+    std::sort( order.begin(), order.end(), [&candidates]( size_t a, size_t b ) {
+        return candidates.confidence[ a ] > candidates.confidence[ b ];
+    } );
+
+    // Gather into score order so the suppression loop reads contiguous memory
+    std::vector< float > x_min( count ), y_min( count ), x_max( count ), y_max( count ), area( count );
+    std::vector< uint32_t > label( count ), view( count );
+    for( size_t i = 0; i < count; i++ )
+    {
+        view[ i ] = views[ order[ i ] ];
+        x_min[ i ] = candidates.x_min[ order[ i ] ];
+        y_min[ i ] = candidates.y_min[ order[ i ] ];
+        x_max[ i ] = candidates.x_max[ order[ i ] ];
+        y_max[ i ] = candidates.y_max[ order[ i ] ];
+        label[ i ] = candidates.label_id[ order[ i ] ];
+        area[ i ] = ( x_max[ i ] - x_min[ i ] ) * ( y_max[ i ] - y_min[ i ] );
+    }
+
+    std::vector< uint8_t > suppressed( count, 0 );
+    std::vector< size_t > keep;
+    for( size_t i = 0; i < count; i++ )
+    {
+        if( suppressed[ i ] )
+        {
+            continue;
+        }
+        keep.push_back( order[ i ] );
+
+        // Branch free so the compiler can vectorise it
+        for( size_t j = i + 1; j < count; j++ )
+        {
+            float width = std::max( 0.0f, std::min( x_max[ i ], x_max[ j ] ) - std::max( x_min[ i ], x_min[ j ] ) );
+            float height = std::max( 0.0f, std::min( y_max[ i ], y_max[ j ] ) - std::max( y_min[ i ], y_min[ j ] ) );
+            float intersection = width * height;
+            float smaller_area = std::min( area[ i ], area[ j ] );
+            suppressed[ j ] |= ( intersection > overlap_threshold * smaller_area ) & ( label[ i ] == label[ j ] ) &
+                               ( view[ i ] != view[ j ] );
+        }
+    }
+
+    return keep;
+}
+
+int Detector::DetectTiled( std::vector< cv::Mat* >& frames, Detections& detections )
+{
+    std::vector< cv::Rect > tiles;
+    ComputeTiles( *frames[ 0 ], tiles );
+
+    size_t views_per_frame = tiles.size() + ( tile_full_view ? 1 : 0 );
+    std::vector< cv::Mat > views;
+    views.reserve( frames.size() * views_per_frame );
+    for( size_t i = 0; i < frames.size(); i++ )
+    {
+        for( const auto& tile : tiles )
+        {
+            views.push_back( ( *frames[ i ] )( tile ) );
+        }
+        if( tile_full_view )
+        {
+            cv::Mat full_view;
+            cv::resize( *frames[ i ], full_view, tiles[ 0 ].size(), 0, 0, cv::INTER_AREA );
+            views.push_back( full_view );
+        }
+    }
+
+    std::vector< cv::Mat* > view_ptrs;
+    view_ptrs.reserve( views.size() );
+    for( auto& view : views )
+    {
+        view_ptrs.push_back( &view );
+    }
+
+    // Every view of every frame in the batch goes through a single session run
+    tensorflow::Tensor input_tensor = CreateTensor( view_ptrs );
+    std::vector< tensorflow::Tensor > output_tensors;
+    if( DetectObjects( input_tensor, output_tensors ) == -1 )
+    {
+        return -1;
+    }
+
+    const float* boxes = output_tensors[ 0 ].flat< float >().data();
+    const float* scores = output_tensors[ 1 ].flat< float >().data();
+    const float* classes = output_tensors[ 2 ].flat< float >().data();
+    const float* num_detections = output_tensors[ 3 ].flat< float >().data();
+    size_t max_detections = output_tensors[ 1 ].dim_size( 1 );
+
+    Detections candidates;
+    std::vector< uint32_t > candidate_views;
+    for( size_t i = 0; i < frames.size(); i++ )
+    {
+        candidates.Clear();
+        candidate_views.clear();
+        for( size_t v = 0; v < views_per_frame; v++ )
+        {
+            size_t view = i * views_per_frame + v;
+            size_t offset = view * max_detections;
+            cv::Rect source =
+            ( v < tiles.size() ) ? tiles[ v ] : cv::Rect( 0, 0, frames[ i ]->cols, frames[ i ]->rows );
+            FilterDetections( boxes + offset * 4,
+                              scores + offset,
+                              classes + offset,
+                              (size_t)num_detections[ view ],
+                              source,
+                              candidates );
+            candidate_views.resize( candidates.Size(), v );
+        }
+
+        for( size_t index : NonMaxSuppression( candidates, candidate_views, nms_threshold ) )
+        {
+            detections.x_min.push_back( candidates.x_min[ index ] );
+            detections.x_max.push_back( candidates.x_max[ index ] );
+            detections.y_min.push_back( candidates.y_min[ index ] );
+            detections.y_max.push_back( candidates.y_max[ index ] );
+            detections.confidence.push_back( candidates.confidence[ index ] );
+            detections.label_id.push_back( candidates.label_id[ index ] );
+        }
+        detections.frame_offsets.push_back( detections.Size() );
+    }
+
+    return 0;
 }
 
 int Detector::DetectObjects( tensorflow::Tensor& input_tensor, std::vector< tensorflow::Tensor >& outputs )
@@ -279,39 +580,32 @@ int Detector::DetectObjects( tensorflow::Tensor& input_tensor, std::vector< tens
     return 0;
 }
 
-int Detector::VisualiseDetection( std::vector< cv::Mat* >& frames,
-                                  std::vector< tensorflow::Tensor >& detection_results )
+int Detector::VisualiseDetection( std::vector< cv::Mat* >& frames, Detections& detections )
 {
-    for( size_t i = 0; i < batch_size; i++ )
+    for( size_t i = 0; i < frames.size(); i++ )
     {
         cv::Mat frame = *frames[ i ];
-        size_t detections = detection_results[ 3 ].vec< float >()( i );
-        for( size_t j = 0; j < detections; j++ )
+        for( size_t j = detections.frame_offsets[ i ]; j < detections.frame_offsets[ i + 1 ]; j++ )
         {
-            auto box = detection_results[ 0 ].tensor< float, 3 >();
-            float confidence = detection_results[ 1 ].matrix< float >()( i, j );
-            float box_class = detection_results[ 2 ].matrix< float >()( i, j );
-            if( confidence >= confidence_threshold && label_map.find( box_class ) != label_map.end() )
-            {
-                size_t pixel_min_y = frame.rows * box( i, j, 0 );
-                size_t pixel_min_x = frame.cols * box( i, j, 1 );
-                size_t pixel_max_y = frame.rows * box( i, j, 2 );
-                size_t pixel_max_x = frame.cols * box( i, j, 3 );
-                size_t blue = ( pixel_min_x >= pixel_max_x ) ? 255 : 0;
-                size_t red = ( pixel_min_y >= pixel_max_y ) ? 255 : 0;
-                cv::rectangle( frame,
-                               cv::Point( pixel_min_x, pixel_min_y ),
-                               cv::Point( pixel_max_x, pixel_max_y ),
-                               cv::Scalar( red, 255, blue ),
-                               2 );
-                cv::putText( frame,
-                             label_map[ box_class ] + " " + std::to_string( ( size_t )( confidence * 100.0f ) ),
-                             cv::Point( pixel_min_x, pixel_min_y ),
-                             cv::FONT_HERSHEY_PLAIN,
-                             1.5,
-                             cv::Scalar( 0, 0, 0 ),
-                             2 );
-            }
+            size_t pixel_min_x = detections.x_min[ j ];
+            size_t pixel_min_y = detections.y_min[ j ];
+            size_t pixel_max_x = detections.x_max[ j ];
+            size_t pixel_max_y = detections.y_max[ j ];
+            size_t blue = ( pixel_min_x >= pixel_max_x ) ? 255 : 0;
+            size_t red = ( pixel_min_y >= pixel_max_y ) ? 255 : 0;
+            cv::rectangle( frame,
+                           cv::Point( pixel_min_x, pixel_min_y ),
+                           cv::Point( pixel_max_x, pixel_max_y ),
+                           cv::Scalar( red, 255, blue ),
+                           2 );
+            cv::putText( frame,
+                         label_names[ detections.label_id[ j ] ] + " " +
+                         std::to_string( ( size_t )( detections.confidence[ j ] * 100.0f ) ),
+                         cv::Point( pixel_min_x, pixel_min_y ),
+                         cv::FONT_HERSHEY_PLAIN,
+                         1.5,
+                         cv::Scalar( 0, 0, 0 ),
+                         2 );
         }
     }
 
@@ -319,39 +613,20 @@ int Detector::VisualiseDetection( std::vector< cv::Mat* >& frames,
 }
 
 int Detector::LogDetection( LogType log_type,
-                            std::vector< cv::Mat* > frames,
-                            std::vector< tensorflow::Tensor >& detection_results,
+                            Detections& detections,
                             std::string& file_name,
                             std::string& outfile_name,
-                            std::vector< size_t > frame_ids )
+                            std::vector< size_t >& frame_ids )
 {
-    for( size_t i = 0; i < batch_size; i++ )
+    for( size_t i = 0; i + 1 < detections.frame_offsets.size(); i++ )
     {
-        std::vector< BoundingBox > log_data;
-        cv::Mat frame = *frames[ i ];
-        size_t detections = detection_results[ 3 ].vec< float >()( i );
-        for( size_t j = 0; j < detections; j++ )
-        {
-            auto box_tensor = detection_results[ 0 ].tensor< float, 3 >();
-            float confidence = detection_results[ 1 ].matrix< float >()( i, j );
-            size_t box_class = (size_t)detection_results[ 2 ].matrix< float >()( i, j );
-            if( confidence >= confidence_threshold && label_map.find( box_class ) != label_map.end() )
-            {
-                BoundingBox box;
-                box.y_min = frame.rows * box_tensor( i, j, 0 );
-                box.x_min = frame.cols * box_tensor( i, j, 1 );
-                box.y_max = frame.rows * box_tensor( i, j, 2 );
-                box.x_max = frame.cols * box_tensor( i, j, 3 );
-
-                box.label_id = (size_t)box_class;
-                box.label = label_map[ box_class ];
-                box.confidence = confidence;
-                log_data.push_back( box );
-            }
-        }
-
-        if( logger->LogDetection(
-            log_type, log_data, file_name, outfile_name, frame_ids.empty() ? -1 : (ssize_t)frame_ids[ i ] ) == -1 )
+        if( logger->LogDetection( log_type,
+                                  detections,
+                                  i,
+                                  label_names,
+                                  file_name,
+                                  outfile_name,
+                                  frame_ids.empty() ? -1 : (ssize_t)frame_ids[ i ] ) == -1 )
         {
             return -1;
         }
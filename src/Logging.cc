@@ -45,10 +45,8 @@ std::string Logger::EscapeInfile( std::string& infile )
     return outfile;
 }
 
-int Logger::LogDetection(
-LogType log_type, std::vector< BoundingBox >& detections, std::string& infile, std::string& outfile, ssize_t frame_id )
+int Logger::OpenWriter( std::ofstream& writer, std::string& infile, std::string& outfile )
 {
-    std::ofstream writer;
     if( outfile == "" )
     {
         writer.open( data_directory + "/" + EscapeInfile( infile ) + ".txt", std::ios_base::out | std::ios_base::app );
@@ -65,6 +63,18 @@ LogType log_type, std::vector< BoundingBox >& detections, std::string& infile, s
         return -1;
     }
 
+    return 0;
+}
+
+int Logger::LogDetection(
+LogType log_type, std::vector< BoundingBox >& detections, std::string& infile, std::string& outfile, ssize_t frame_id )
+{
+    std::ofstream writer;
+    if( OpenWriter( writer, infile, outfile ) == -1 )
+    {
+        return -1;
+    }
+
     writer << infile << std::endl;
     writer << std::to_string( detections.size() ) << delim << std::to_string( frame_id ) << std::endl;
 
@@ -84,6 +94,44 @@ LogType log_type, std::vector< BoundingBox >& detections, std::string& infile, s
     return 0;
 }
 
+int Logger::LogDetection( LogType log_type,
+                          Detections& detections,
+                          size_t frame,
+                          std::vector< std::string >& label_names,
+                          std::string& infile,
+                          std::string& outfile,
+                          ssize_t frame_id )
+{
+    std::ofstream writer;
+    if( OpenWriter( writer, infile, outfile ) == -1 )
+    {
+        return -1;
+    }
+
+    size_t begin = detections.frame_offsets[ frame ];
+    size_t end = detections.frame_offsets[ frame + 1 ];
+    writer << infile << std::endl;
+    writer << std::to_string( end - begin ) << delim << std::to_string( frame_id ) << std::endl;
+
+    // Same format as the BoundingBox overload, pixel coordinates are truncated
+    for( size_t i = begin; i < end; i++ )
+    {
+        writer << std::to_string( ( size_t )( detections.x_min[ i ] ) ) << delim
+               << std::to_string( ( size_t )( detections.x_max[ i ] ) ) << delim
+               << std::to_string( ( size_t )( detections.y_min[ i ] ) ) << delim
+               << std::to_string( ( size_t )( detections.y_max[ i ] ) ) << delim
+               << std::to_string( detections.label_id[ i ] ) << delim << label_names[ detections.label_id[ i ] ]
+               << delim << std::to_string( detections.confidence[ i ] ) << std::endl;
+    }
+    // End with empty line
+    writer << std::endl;
+
+
+    writer.close();
+
+    return 0;
+}
+
 void Logger::LogError( std::string message, ErrorType error )
 {
     if( error_file != "" )
@@ -0,0 +1,235 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "Detection.h"
+#include "Logging.h"
+
+namespace py = pybind11;
+
+namespace MajorProject
+{
+/*
+ * Record layout of the numpy structured arrays returned to python. Signed so differences do not wrap in numpy
+ */
+struct PyDetection
+{
+    int32_t x_min;
+    int32_t x_max;
+    int32_t y_min;
+    int32_t y_max;
+    float confidence;
+    int32_t label_id;
+};
+
+/*
+ * @WrapFrames	Wraps a HxWx3 or NxHxWx3 uint8 buffer in cv::Mat headers without copying
+ *
+ * Rows may be padded (e.g. a crop of a larger array) but pixels within a row must be packed.
+ */
+std::vector< cv::Mat > WrapFrames( py::buffer_info& info )
+{
+    if( info.format != py::format_descriptor< uint8_t >::format() )
+    {
+        throw py::value_error( "Frames must be uint8" );
+    }
+    if( info.ndim != 3 && info.ndim != 4 )
+    {
+        throw py::value_error( "Frames must have shape (height, width, 3) or (batch, height, width, 3)" );
+    }
+
+    size_t offset = info.ndim - 3;
+    ssize_t rows = info.shape[ offset ];
+    ssize_t cols = info.shape[ offset + 1 ];
+    ssize_t channels = info.shape[ offset + 2 ];
+    if( channels != 3 )
+    {
+        throw py::value_error( "Frames must have 3 channels" );
+    }
+    if( info.strides[ offset + 2 ] != 1 || info.strides[ offset + 1 ] != channels || info.strides[ offset ] <= 0 )
+    {
+        throw py::value_error( "Frame pixels must be contiguous, use numpy.ascontiguousarray" );
+    }
+
+    ssize_t batch = ( info.ndim == 4 ) ? info.shape[ 0 ] : 1;
+    ssize_t batch_stride = ( info.ndim == 4 ) ? info.strides[ 0 ] : 0;
+    std::vector< cv::Mat > frames;
+    frames.reserve( batch );
+    for( ssize_t i = 0; i < batch; i++ )
+    {
+        uint8_t* data = static_cast< uint8_t* >( info.ptr ) + i * batch_stride;
+        frames.emplace_back( rows, cols, CV_8UC3, data, info.strides[ offset ] );
+    }
+
+    return frames;
+}
+
+py::array_t< PyDetection > ToArray( Detections& detections, size_t frame )
+{
+    size_t begin = detections.frame_offsets[ frame ];
+    size_t end = detections.frame_offsets[ frame + 1 ];
+    py::array_t< PyDetection > array( end - begin );
+    auto records = array.mutable_unchecked< 1 >();
+    for( size_t i = begin; i < end; i++ )
+    {
+        records( i - begin ).x_min = detections.x_min[ i ];
+        records( i - begin ).x_max = detections.x_max[ i ];
+        records( i - begin ).y_min = detections.y_min[ i ];
+        records( i - begin ).y_max = detections.y_max[ i ];
+        records( i - begin ).confidence = detections.confidence[ i ];
+        records( i - begin ).label_id = detections.label_id[ i ];
+    }
+
+    return array;
+}
+
+py::object Detect( Detector& detector, py::buffer buffer )
+{
+    py::buffer_info info = buffer.request();
+    std::vector< cv::Mat > frames = WrapFrames( info );
+    std::vector< cv::Mat* > frame_ptrs;
+    for( auto& frame : frames )
+    {
+        frame_ptrs.push_back( &frame );
+    }
+
+    Detections detections;
+    int status;
+    {
+        // info keeps the buffer alive while the session runs
+        py::gil_scoped_release release;
+        status = detector.DetectFrames( frame_ptrs, detections );
+    }
+    if( status == -1 )
+    {
+        throw std::runtime_error( "Detection failed, see log for details" );
+    }
+
+    if( info.ndim == 3 )
+    {
+        return ToArray( detections, 0 );
+    }
+    py::list results;
+    for( size_t i = 0; i < frames.size(); i++ )
+    {
+        results.append( ToArray( detections, i ) );
+    }
+    return results;
+}
+
+void CheckStatus( int status, const char* message )
+{
+    if( status == -1 )
+    {
+        throw std::runtime_error( message );
+    }
+}
+}
+
+PYBIND11_MODULE( majorproject, m )
+{
+    using namespace MajorProject;
+
+    m.doc() = "Python bindings for the MajorProject detection engine";
+
+    PYBIND11_NUMPY_DTYPE( PyDetection, x_min, x_max, y_min, y_max, confidence, label_id );
+
+    py::enum_< LogType >( m, "LogType" ).value( "MP4", LogType::MP4 ).value( "JPEG", LogType::JPEG );
+
+    py::enum_< ErrorType >( m, "ErrorType" )
+    .value( "FATAL", ErrorType::FATAL )
+    .value( "WARNING", ErrorType::WARNING )
+    .value( "INFO", ErrorType::INFO );
+
+    py::class_< Logger >( m, "Logger" )
+    .def( py::init< std::string, std::string >(), py::arg( "data_directory" ), py::arg( "error_file" ) = "" )
+    .def( "log_error", &Logger::LogError, py::arg( "message" ), py::arg( "error" ) )
+    .def( "log_detection",
+          []( Logger& logger,
+              LogType log_type,
+              py::array_t< PyDetection > detections,
+              std::string infile,
+              std::string outfile,
+              ssize_t frame_id,
+              std::map< size_t, std::string > labels ) {
+              auto records = detections.unchecked< 1 >();
+              std::vector< BoundingBox > boxes( records.shape( 0 ) );
+              for( ssize_t i = 0; i < records.shape( 0 ); i++ )
+              {
+                  boxes[ i ].x_min = records( i ).x_min;
+                  boxes[ i ].x_max = records( i ).x_max;
+                  boxes[ i ].y_min = records( i ).y_min;
+                  boxes[ i ].y_max = records( i ).y_max;
+                  boxes[ i ].confidence = records( i ).confidence;
+                  boxes[ i ].label_id = records( i ).label_id;
+                  auto label = labels.find( boxes[ i ].label_id );
+                  boxes[ i ].label = ( label != labels.end() ) ? label->second : "";
+              }
+              CheckStatus( logger.LogDetection( log_type, boxes, infile, outfile, frame_id ),
+                           "Failed to log detection" );
+          },
+          py::arg( "log_type" ),
+          py::arg( "detections" ),
+          py::arg( "infile" ),
+          py::arg( "outfile" ) = "",
+          py::arg( "frame_id" ) = -1,
+          py::arg( "labels" ) = std::map< size_t, std::string >() )
+    .def( "set_data_dir", []( Logger& logger, std::string data_directory ) { logger.SetDataDir( data_directory ); } )
+    .def( "set_error_file", []( Logger& logger, std::string error_file ) { logger.SetErrorFile( error_file ); } )
+    .def( "set_delim", []( Logger& logger, std::string delim ) { logger.SetDelim( delim ); } );
+
+    py::class_< Detector >( m, "Detector" )
+    .def( py::init< Logger* >(), py::arg( "logger" ), py::keep_alive< 1, 2 >() )
+    .def( "init_session",
+          []( Detector& detector, std::string model_path ) {
+              int status;
+              {
+                  py::gil_scoped_release release;
+                  status = detector.InitSession( model_path );
+              }
+              CheckStatus( status, "Failed to initialise session, see log for details" );
+          },
+          py::arg( "model_path" ) )
+    .def( "close_session",
+          []( Detector& detector ) {
+              CheckStatus( detector.CloseSession(), "Failed to close session, see log for details" );
+          } )
+    .def( "detect",
+          &Detect,
+          py::arg( "frames" ),
+          "Detects objects in a (height, width, 3) uint8 frame or a (batch, height, width, 3) batch of frames.\n"
+          "The frame memory is read in place. Returns a structured array of detections, or a list of them for a batch." )
+    .def( "proc_mp4",
+          []( Detector& detector, std::string mp4_path, std::string outfile, bool visualise ) {
+              int status;
+              {
+                  py::gil_scoped_release release;
+                  status = detector.ProcMP4( mp4_path, outfile, visualise );
+              }
+              CheckStatus( status, "Failed to process mp4, see log for details" );
+          },
+          py::arg( "mp4_path" ),
+          py::arg( "outfile" ) = "",
+          py::arg( "visualise" ) = false )
+    .def( "is_quantized", &Detector::IsQuantized )
+    .def( "has_quantized_weights", &Detector::HasQuantizedWeights )
+    .def( "set_confidence_threshold", &Detector::SetConfidenceThreshold )
+    .def( "set_label_map",
+          []( Detector& detector, std::map< size_t, std::string > label_map ) {
+              detector.SetLabelMap( std::move( label_map ) );
+          } )
+    .def( "get_label_names", &Detector::GetLabelNames )
+    .def( "set_database", &Detector::SetDatabase, py::keep_alive< 1, 2 >() )
+    .def( "set_batch_size", &Detector::SetBatchSize )
+    .def( "set_session_gpu_memory_fraction", &Detector::SetSessionGpuMemoryFraction )
+    .def( "set_allow_growth", &Detector::SetAllowGrowth )
+    .def( "set_gpu_device_id", &Detector::SetGpuDeviceId )
+    .def( "set_memmapped_model", &Detector::SetMemmappedModel )
+    .def( "set_tiling", &Detector::SetTiling )
+    .def( "set_tile_size", &Detector::SetTileSize )
+    .def( "set_tile_overlap", &Detector::SetTileOverlap )
+    .def( "set_tile_full_view", &Detector::SetTileFullView )
+    .def( "set_nms_threshold", &Detector::SetNmsThreshold )
+    .def( "set_tensorflow_log_level", &Detector::SetTensorflowLogLevel )
+    .def( "set_tensorflow_vlog_level", &Detector::SetTensorflowVLogLevel );
+}
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Converts a frozen graph into tensorflow's memmapped format so constant weights can be mapped read only from the
+# file and shared between detector processes through the page cache. Load the result with
+# Detector::SetMemmappedModel( true ).
+#
+# Usage: memmap_model.sh in-model.pb out-model.mmpb
+#
+# Requires the convert_graphdef_memmapped_format tool. Build it from the tensorflow root directory with
+#   bazel build -c opt //tensorflow/contrib/util:convert_graphdef_memmapped_format
+# and either add it to PATH or point TENSORFLOW_DIR at the tensorflow root directory.
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 in-model.pb out-model.mmpb"
+    exit 1
+fi
+
+CONVERT=$(command -v convert_graphdef_memmapped_format)
+if [ -z "$CONVERT" ]; then
+    CONVERT=${TENSORFLOW_DIR:-.}/bazel-bin/tensorflow/contrib/util/convert_graphdef_memmapped_format
+fi
+if [ ! -x "$CONVERT" ]; then
+    echo "convert_graphdef_memmapped_format not found. Build it with tensorflow and set TENSORFLOW_DIR"
+    exit 1
+fi
+
+"$CONVERT" --in_graph="$1" --out_graph="$2"
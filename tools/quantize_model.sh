@@ -0,0 +1,55 @@
+#!/bin/bash
+# Converts a frozen float detection graph into an 8-bit quantized graph using tensorflow's graph transforms.
+#
+# Usage: quantize_model.sh in-model.pb out-model.pb [full|weights]
+#
+#   full     Replace float ops with their quantized equivalents where tensorflow has kernels for them (default)
+#   weights  Only store weights as 8 bit. The model file is ~4x smaller but the weights are folded back to float
+#            when the session is created, so it runs no faster than the float model
+#
+# Requires the transform_graph tool. Build it from the tensorflow root directory with
+#   bazel build -c opt //tensorflow/tools/graph_transforms:transform_graph
+# and either add it to PATH or point TENSORFLOW_DIR at the tensorflow root directory.
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 in-model.pb out-model.pb [weights|full]"
+    exit 1
+fi
+
+IN_GRAPH=$1
+OUT_GRAPH=$2
+MODE=${3:-full}
+
+TRANSFORM_GRAPH=$(command -v transform_graph)
+if [ -z "$TRANSFORM_GRAPH" ]; then
+    TRANSFORM_GRAPH=${TENSORFLOW_DIR:-.}/bazel-bin/tensorflow/tools/graph_transforms/transform_graph
+fi
+if [ ! -x "$TRANSFORM_GRAPH" ]; then
+    echo "transform_graph not found. Build it with tensorflow and set TENSORFLOW_DIR"
+    exit 1
+fi
+
+INPUTS="image_tensor"
+OUTPUTS="detection_boxes,detection_scores,detection_classes,num_detections"
+
+case $MODE in
+    weights)
+        TRANSFORMS="strip_unused_nodes(type=uint8) fold_constants(ignore_errors=true) fold_batch_norms fold_old_batch_norms
+                    quantize_weights sort_by_execution_order"
+        ;;
+    full)
+        TRANSFORMS="strip_unused_nodes(type=uint8) fold_constants(ignore_errors=true) fold_batch_norms fold_old_batch_norms
+                    quantize_weights quantize_nodes strip_unused_nodes(type=uint8) sort_by_execution_order"
+        ;;
+    *)
+        echo "Unknown mode: $MODE"
+        exit 1
+        ;;
+esac
+
+"$TRANSFORM_GRAPH" \
+    --in_graph="$IN_GRAPH" \
+    --out_graph="$OUT_GRAPH" \
+    --inputs="$INPUTS" \
+    --outputs="$OUTPUTS" \
+    --transforms="$TRANSFORMS"